@@ -19,6 +19,19 @@
 
 #include "sha2_hasher.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA2_SHANI
+#include <immintrin.h>
+#include <utils/cpu_feature.h>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && \
+	__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SHA2_ARMV8
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
+
 
 typedef struct private_sha512_hasher_t private_sha512_hasher_t;
 
@@ -124,6 +137,149 @@ static const uint64_t sha512_K[80] = {
 };
 
 
+#ifdef SHA2_SHANI
+
+/**
+ * TRUE if the CPU supports the SHA instruction set extensions, determined
+ * once when creating the first hasher instance.
+ */
+static signed char have_shani = -1;
+
+/*
+ * Hash a single 512-bit block using the SHA instruction set extensions.
+ * Compiled with a target attribute instead of plugin-wide flags, so the
+ * portable code path still runs on CPUs without these instructions.
+ */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void sha256_transform_shani(uint32_t state[8],
+								   const unsigned char *datap)
+{
+	__m128i state0, state1, abef_save, cdgh_save;
+	__m128i msg, tmp, msg0, msg1, msg2, msg3;
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+										0x0405060700010203ULL);
+	int i;
+
+	/* rearrange the state from its linear layout into the ABEF/CDGH
+	 * register pair the SHA256RNDS2 instruction operates on */
+	tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);
+	state1 = _mm_shuffle_epi32(state1, 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	abef_save = state0;
+	cdgh_save = state1;
+
+	/* read the data, big endian byte order */
+	msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(datap +  0)),
+							mask);
+	msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(datap + 16)),
+							mask);
+	msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(datap + 32)),
+							mask);
+	msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(datap + 48)),
+							mask);
+
+	/* four rounds per iteration, msg0 holds the oldest message words and
+	 * is extended in place before the registers are rotated */
+	for (i = 0; i < 16; i++)
+	{
+		msg = _mm_add_epi32(msg0,
+					_mm_loadu_si128((const __m128i*)&sha256_K[i * 4]));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0E);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		if (i < 12)
+		{
+			msg0 = _mm_sha256msg2_epu32(
+						_mm_add_epi32(_mm_sha256msg1_epu32(msg0, msg1),
+									  _mm_alignr_epi8(msg3, msg2, 4)), msg3);
+		}
+		tmp = msg0;
+		msg0 = msg1;
+		msg1 = msg2;
+		msg2 = msg3;
+		msg3 = tmp;
+	}
+
+	state0 = _mm_add_epi32(state0, abef_save);
+	state1 = _mm_add_epi32(state1, cdgh_save);
+
+	/* rearrange the state back into its linear layout */
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+	_mm_storeu_si128((__m128i*)&state[0], state0);
+	_mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#endif /* SHA2_SHANI */
+
+#ifdef SHA2_ARMV8
+
+/**
+ * TRUE if the CPU implements the ARMv8 SHA-256 Crypto Extensions,
+ * determined once when creating the first hasher instance.
+ */
+static signed char have_sha2ce = -1;
+
+/*
+ * Hash a single 512-bit block using the ARMv8 Crypto Extensions.
+ * Compiled with a target attribute instead of plugin-wide flags, so the
+ * portable code path still runs on CPUs without these instructions.
+ */
+__attribute__((target("+crypto")))
+static void sha256_transform_armv8(uint32_t state[8],
+								   const unsigned char *datap)
+{
+	uint32x4_t state0, state1, abcd_save, efgh_save;
+	uint32x4_t msg, tmp, msg0, msg1, msg2, msg3;
+	int i;
+
+	state0 = vld1q_u32(&state[0]);
+	state1 = vld1q_u32(&state[4]);
+
+	abcd_save = state0;
+	efgh_save = state1;
+
+	/* read the data, big endian byte order */
+	msg0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(datap +  0)));
+	msg1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(datap + 16)));
+	msg2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(datap + 32)));
+	msg3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(datap + 48)));
+
+	/* four rounds per iteration, msg0 holds the oldest message words and
+	 * is extended in place before the registers are rotated */
+	for (i = 0; i < 16; i++)
+	{
+		msg = vaddq_u32(msg0, vld1q_u32(&sha256_K[i * 4]));
+		tmp = state0;
+		state0 = vsha256hq_u32(state0, state1, msg);
+		state1 = vsha256h2q_u32(state1, tmp, msg);
+		if (i < 12)
+		{
+			msg0 = vsha256su1q_u32(vsha256su0q_u32(msg0, msg1), msg2, msg3);
+		}
+		tmp = msg0;
+		msg0 = msg1;
+		msg1 = msg2;
+		msg2 = msg3;
+		msg3 = tmp;
+	}
+
+	state0 = vaddq_u32(state0, abcd_save);
+	state1 = vaddq_u32(state1, efgh_save);
+
+	vst1q_u32(&state[0], state0);
+	vst1q_u32(&state[4], state1);
+}
+
+#endif /* SHA2_ARMV8 */
+
 /* set macros for SHA256 */
 #define Ch(x,y,z)   (((x) & (y)) ^ ((~(x)) & (z)))
 #define Maj(x,y,z)  (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
@@ -145,6 +301,23 @@ static void sha256_transform(private_sha256_hasher_t *ctx,
 	uint32_t       a, b, c, d, e, f, g, h;
 	uint32_t       T1, T2, W[64], Wm2, Wm15;
 
+#ifdef SHA2_SHANI
+	if (have_shani == 1)
+	{
+		sha256_transform_shani(ctx->sha_H, datap);
+		ctx->sha_blocks++;
+		return;
+	}
+#endif
+#ifdef SHA2_ARMV8
+	if (have_sha2ce == 1)
+	{
+		sha256_transform_armv8(ctx->sha_H, datap);
+		ctx->sha_blocks++;
+		return;
+	}
+#endif
+
 	/* read the data, big endian byte order */
 	j = 0;
 	do {
@@ -592,6 +765,23 @@ METHOD(hasher_t, destroy, void,
  */
 sha2_hasher_t *sha2_hasher_create(hash_algorithm_t algorithm)
 {
+#ifdef SHA2_SHANI
+	if (have_shani == -1)
+	{
+		have_shani = cpu_feature_available(CPU_FEATURE_SHANI);
+	}
+#endif
+#ifdef SHA2_ARMV8
+	if (have_sha2ce == -1)
+	{
+#ifdef HWCAP_SHA2
+		have_sha2ce = !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+#else
+		have_sha2ce = 0;
+#endif
+	}
+#endif
+
 	switch (algorithm)
 	{
 		case HASH_SHA224:
@@ -32,6 +32,9 @@ typedef enum {
 	CPUID1_ECX_AVX =				(1 << 28),
 	CPUID1_ECX_RDRAND =				(1 << 30),
 
+	/* Structured Extended Feature Flags, CPUID(7) with ECX=0 */
+	CPUID7_EBX_SHANI =				(1 << 29),
+
 	/* For CentaurHauls cpuid(0xC0000001) */
 	CPUIDC1_EDX_RNG_AVAILABLE =		(1 <<  2),
 	CPUIDC1_EDX_RNG_ENABLED =		(1 <<  3),
@@ -46,19 +49,21 @@ typedef enum {
 } cpuid_flag_t;
 
 /**
- * Get cpuid for info, return eax, ebx, ecx and edx.
- * -fPIC requires to save ebx on IA-32.
+ * Get cpuid for info, return eax, ebx, ecx and edx. ECX is zeroed on input,
+ * as some leaves (e.g. the Structured Extended Feature Flags) select a
+ * sub-leaf through it. -fPIC requires to save ebx on IA-32.
  */
 static void cpuid(u_int op, u_int *a, u_int *b, u_int *c, u_int *d)
 {
 #ifdef __x86_64__
-	asm("cpuid" : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d) : "a" (op));
+	asm("cpuid" : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+		: "a" (op), "c" (0));
 #else /* __i386__ */
 	asm("pushl %%ebx;"
 		"cpuid;"
 		"movl %%ebx, %1;"
 		"popl %%ebx;"
-		: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d) : "a" (op));
+		: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d) : "a" (op), "c" (0));
 #endif /* __x86_64__ / __i386__*/
 }
 
@@ -105,9 +110,10 @@ cpu_feature_t cpu_feature_get_all()
 {
 	char vendor[3 * sizeof(uint32_t) + 1];
 	cpu_feature_t f = 0;
-	u_int a, b, c, d;
+	u_int a, b, c, d, leaves;
 
 	cpuid(0, &a, &b, &c, &d);
+	leaves = a;
 	/* VendorID string is in b-d-c (yes, in this order) */
 	snprintf(vendor, sizeof(vendor), "%.4s%.4s%.4s", &b, &d, &c);
 
@@ -126,6 +132,14 @@ cpu_feature_t cpu_feature_get_all()
 	f |= f2f(c, CPUID1_ECX_AVX, CPU_FEATURE_AVX);
 	f |= f2f(c, CPUID1_ECX_RDRAND, CPU_FEATURE_RDRAND);
 
+	if (leaves >= 7)
+	{
+		cpuid(7, &a, &b, &c, &d);
+
+		/* check Structured Extended Feature Flags for CPUID(7) */
+		f |= f2f(b, CPUID7_EBX_SHANI, CPU_FEATURE_SHANI);
+	}
+
 	if (streq(vendor, "CentaurHauls"))
 	{
 		cpuid(0xc0000000, &a, &b, &c, &d);
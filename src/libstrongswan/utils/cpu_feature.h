@@ -37,6 +37,7 @@ typedef enum {
 	CPU_FEATURE_RDRAND =						(1 <<  8),
 	CPU_FEATURE_AESNI =							(1 <<  9),
 	CPU_FEATURE_PCLMULQDQ =						(1 << 10),
+	CPU_FEATURE_SHANI =							(1 << 11),
 	/** Via Padlock Security features */
 	CPU_FEATURE_PADLOCK_RNG_AVAILABLE =			(1 << 22),
 	CPU_FEATURE_PADLOCK_RNG_ENABLED =			(1 << 23),
@@ -25,6 +25,7 @@
 #include <credentials/sets/mem_cred.h>
 
 #include "tls_socket.h"
+#include "tls_cache.h"
 
 /**
  * Credentials for authentication
@@ -472,11 +473,13 @@ END_SETUP
  */
 typedef struct {
 	tls_version_t version;
+	tls_version_t min_version;
 	uint16_t port;
 	char *addr;
 	chunk_t data;
 	int fd;
 	bool cauth;
+	tls_cache_t *cache;
 } echo_server_config_t;
 
 /**
@@ -493,6 +496,7 @@ START_TEARDOWN(teardown_creds)
 	if (server_config)
 	{
 		shutdown(server_config->fd, SHUT_RDWR);
+		DESTROY_IF(server_config->cache);
 		free(server_config);
 		server_config = NULL;
 	}
@@ -534,8 +538,8 @@ static job_requeue_t serve_echo(echo_server_config_t *config)
 			break;
 		}
 
-		tls = tls_socket_create(TRUE, server, client, cfd, NULL,
-								TLS_SUPPORTED_MIN, config->version,
+		tls = tls_socket_create(TRUE, server, client, cfd, config->cache,
+								config->min_version, config->version,
 								TLS_FLAG_ENCRYPTION_OPTIONAL);
 		ck_assert(tls != NULL);
 
@@ -613,8 +617,8 @@ static void run_echo_client(echo_server_config_t *config)
 	ck_assert(fd != -1);
 	ck_assert(connect(fd, host->get_sockaddr(host),
 					  *host->get_sockaddr_len(host)) != -1);
-	tls = tls_socket_create(FALSE, server, client, fd, NULL,
-							TLS_SUPPORTED_MIN, config->version,
+	tls = tls_socket_create(FALSE, server, client, fd, config->cache,
+							config->min_version, config->version,
 							TLS_FLAG_ENCRYPTION_OPTIONAL);
 	ck_assert(tls != NULL);
 
@@ -662,6 +666,7 @@ static echo_server_config_t *create_config(tls_version_t version, uint16_t port,
 
 	INIT(config,
 		.version = version,
+		.min_version = TLS_SUPPORTED_MIN,
 		.addr = "127.0.0.1",
 		.port = port,
 		.cauth = cauth,
@@ -693,6 +698,55 @@ static void test_tls(tls_version_t version, uint16_t port, bool cauth, u_int i)
 	free(suites);
 }
 
+/**
+ * Common test wrapper for session resumption via an abbreviated handshake
+ */
+static void test_tls_resumption(tls_version_t version, uint16_t port,
+								bool cauth, u_int i)
+{
+	echo_server_config_t *client;
+	identification_t *id;
+	tls_cipher_suite_t *suites;
+	chunk_t session, resumed;
+	char suite[128];
+	int count;
+
+	/* fix the minimum version, so the client offers encrypt-then-MAC for
+	 * CBC suites on TLS 1.1 and newer */
+	server_config = create_config(version, port, cauth);
+	server_config->min_version = version;
+	server_config->cache = tls_cache_create(4, 60);
+	client = create_config(version, port, cauth);
+	client->min_version = version;
+	client->cache = tls_cache_create(4, 60);
+
+	start_echo_server(server_config);
+
+	count = tls_crypto_get_supported_suites(TRUE, version, &suites);
+	ck_assert(i < count);
+	snprintf(suite, sizeof(suite), "%N", tls_cipher_suite_names, suites[i]);
+	lib->settings->set_str(lib->settings, "%s.tls.suites", suite, lib->ns);
+
+	/* full handshake, followed by an abbreviated one resuming the session */
+	run_echo_client(client);
+	id = identification_create_from_string(client->addr);
+	session = client->cache->check(client->cache, id);
+	ck_assert_msg(session.len, "no session cached after full handshake");
+
+	run_echo_client(client);
+	resumed = client->cache->check(client->cache, id);
+	/* a full handshake would have cached a new session identifier */
+	ck_assert_msg(chunk_equals(session, resumed),
+				  "second handshake did not resume the session");
+
+	chunk_free(&session);
+	chunk_free(&resumed);
+	id->destroy(id);
+	free(suites);
+	client->cache->destroy(client->cache);
+	free(client);
+}
+
 /**
  * TLS curve test wrapper function
  */
@@ -918,6 +972,18 @@ START_TEST(test_tls10_mutual)
 }
 END_TEST
 
+START_TEST(test_tls12_resumption)
+{
+	test_tls_resumption(TLS_1_2, 5677, FALSE, _i);
+}
+END_TEST
+
+START_TEST(test_tls11_resumption)
+{
+	test_tls_resumption(TLS_1_1, 5678, FALSE, _i);
+}
+END_TEST
+
 #define add_tls_test(func, version) \
 	tcase_add_loop_test(tc, func, 0, \
 						tls_crypto_get_supported_suites(TRUE, version, NULL));
@@ -1017,6 +1083,16 @@ Suite *socket_suite_create()
 	add_tls_test(test_tls10_mutual, TLS_1_0);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("TLS 1.2/resume");
+	tcase_add_checked_fixture(tc, setup_all_creds, teardown_creds);
+	add_tls_test(test_tls12_resumption, TLS_1_2);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("TLS 1.1/resume");
+	tcase_add_checked_fixture(tc, setup_all_creds, teardown_creds);
+	add_tls_test(test_tls11_resumption, TLS_1_1);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
 
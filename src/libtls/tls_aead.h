@@ -135,6 +135,22 @@ tls_aead_t *tls_aead_create_explicit(integrity_algorithm_t mac,
 tls_aead_t *tls_aead_create_implicit(integrity_algorithm_t mac,
 								encryption_algorithm_t encr, size_t encr_size);
 
+/**
+ * Create a tls_aead instance using traditional transforms in
+ * encrypt-then-MAC mode, explicit IV.
+ *
+ * The MAC is computed over the encrypted record including the explicit IV,
+ * as negotiated through the encrypt_then_mac extension defined in RFC 7366.
+ * Usable with TLS 1.1 and TLS 1.2.
+ *
+ * @param mac			integrity protection algorithm
+ * @param encr			encryption algorithm
+ * @param encr_size		encryption key size, in bytes
+ * @return				TLS AEAD transform
+ */
+tls_aead_t *tls_aead_create_etm(integrity_algorithm_t mac,
+								encryption_algorithm_t encr, size_t encr_size);
+
 /**
  * Create a tls_aead instance using NULL encryption.
  *
@@ -172,4 +188,18 @@ tls_aead_t *tls_aead_create_aead(encryption_algorithm_t encr, size_t encr_size);
  */
 tls_aead_t *tls_aead_create_seq(encryption_algorithm_t encr, size_t encr_size);
 
+/**
+ * Create a tls_aead instance using a real AEAD cipher with an XORed nonce,
+ * but the traditional TLS 1.2 record format.
+ *
+ * As with TLS 1.3, the nonce is the sequence number XORed with a static
+ * value derived from the key material, and no explicit nonce is sent with
+ * the record. Used for ChaCha20-Poly1305 in TLS 1.2 (RFC 7905).
+ *
+ * @param encr			AEAD encryption algorithm
+ * @param encr_size		encryption key size, in bytes
+ * @return				TLS AEAD transform
+ */
+tls_aead_t *tls_aead_create_xor(encryption_algorithm_t encr, size_t encr_size);
+
 #endif /** TLS_AEAD_H_ @}*/
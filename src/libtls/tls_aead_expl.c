@@ -44,6 +44,21 @@ struct private_tls_aead_t {
 	 * IV generator
 	 */
 	iv_gen_t *iv_gen;
+
+	/**
+	 * Crypter block size, queried once at creation
+	 */
+	uint8_t block_size;
+
+	/**
+	 * Crypter IV size, queried once at creation
+	 */
+	uint8_t iv_size;
+
+	/**
+	 * Signer MAC size, queried once at creation
+	 */
+	uint8_t mac_size;
 };
 
 /**
@@ -75,15 +90,14 @@ METHOD(tls_aead_t, encrypt, bool,
 	{
 		return FALSE;
 	}
-	bs = this->crypter->get_block_size(this->crypter);
+	bs = this->block_size;
 	padlen = pad_len(data->len + mac.len + 1, bs);
 
 	padding = chunk_alloca(padlen);
 	memset(padding.ptr, padlen, padding.len);
 
 	/* TLSv1.1 uses random IVs, prepended to record */
-	iv.len = this->crypter->get_iv_size(this->crypter);
-	iv = chunk_alloca(iv.len);
+	iv = chunk_alloca(this->iv_size);
 	if (!this->iv_gen->get_iv(this->iv_gen, seq, iv.len, iv.ptr))
 	{
 		return FALSE;
@@ -108,14 +122,14 @@ METHOD(tls_aead_t, decrypt, bool,
 	sigheader_t hdr;
 	size_t i;
 
-	iv.len = this->crypter->get_iv_size(this->crypter);
+	iv.len = this->iv_size;
 	if (data->len < iv.len)
 	{
 		return FALSE;
 	}
 	iv.ptr = data->ptr;
 	*data = chunk_skip(*data, iv.len);
-	bs = this->crypter->get_block_size(this->crypter);
+	bs = this->block_size;
 	if (data->len < bs || data->len % bs)
 	{
 		return FALSE;
@@ -137,7 +151,7 @@ METHOD(tls_aead_t, decrypt, bool,
 		data->len -= padlen + 1;
 	}
 
-	bs = this->signer->get_block_size(this->signer);
+	bs = this->mac_size;
 	if (data->len < bs)
 	{
 		return FALSE;
@@ -226,5 +240,11 @@ tls_aead_t *tls_aead_create_explicit(integrity_algorithm_t mac,
 		return NULL;
 	}
 
+	/* these are constant for the lifetime of the transform, avoid querying
+	 * them again for every record */
+	this->block_size = this->crypter->get_block_size(this->crypter);
+	this->iv_size = this->crypter->get_iv_size(this->crypter);
+	this->mac_size = this->signer->get_block_size(this->signer);
+
 	return &this->public;
 }
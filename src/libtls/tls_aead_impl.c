@@ -39,9 +39,24 @@ struct private_tls_aead_t {
 	signer_t *signer;
 
 	/**
-	 * Next implicit IV
+	 * Next implicit IV, embedded to avoid a heap allocation
 	 */
-	chunk_t iv;
+	uint8_t iv[16];
+
+	/**
+	 * Size of the implicit IV
+	 */
+	uint8_t iv_size;
+
+	/**
+	 * Crypter block size, queried once at creation
+	 */
+	uint8_t block_size;
+
+	/**
+	 * Signer MAC size, queried once at creation
+	 */
+	uint8_t mac_size;
 };
 
 /**
@@ -73,7 +88,7 @@ METHOD(tls_aead_t, encrypt, bool,
 	{
 		return FALSE;
 	}
-	bs = this->crypter->get_block_size(this->crypter);
+	bs = this->block_size;
 	padlen = pad_len(data->len + mac.len + 1, bs);
 
 	padding = chunk_alloca(padlen);
@@ -81,16 +96,17 @@ METHOD(tls_aead_t, encrypt, bool,
 
 	*data = chunk_cat("mmcc", *data, mac, padding, chunk_from_thing(padlen));
 	/* encrypt inline */
-	if (!this->crypter->encrypt(this->crypter, *data, this->iv, NULL))
+	if (!this->crypter->encrypt(this->crypter, *data,
+								chunk_create(this->iv, this->iv_size), NULL))
 	{
 		return FALSE;
 	}
-	if (data->len < this->iv.len)
+	if (data->len < this->iv_size)
 	{
 		return FALSE;
 	}
 	/* next record IV is last ciphertext block of this record */
-	memcpy(this->iv.ptr, data->ptr + data->len - this->iv.len, this->iv.len);
+	memcpy(this->iv, data->ptr + data->len - this->iv_size, this->iv_size);
 	return TRUE;
 }
 
@@ -103,14 +119,14 @@ METHOD(tls_aead_t, decrypt, bool,
 	sigheader_t hdr;
 	size_t i;
 
-	bs = this->crypter->get_block_size(this->crypter);
-	if (data->len < bs || data->len < this->iv.len || data->len % bs)
+	bs = this->block_size;
+	if (data->len < bs || data->len < this->iv_size || data->len % bs)
 	{
 		return FALSE;
 	}
-	iv = chunk_alloca(this->iv.len);
-	memcpy(iv.ptr, this->iv.ptr, this->iv.len);
-	memcpy(this->iv.ptr, data->ptr + data->len - this->iv.len, this->iv.len);
+	iv = chunk_alloca(this->iv_size);
+	memcpy(iv.ptr, this->iv, this->iv_size);
+	memcpy(this->iv, data->ptr + data->len - this->iv_size, this->iv_size);
 	if (!this->crypter->decrypt(this->crypter, *data, iv, NULL))
 	{
 		return FALSE;
@@ -128,7 +144,7 @@ METHOD(tls_aead_t, decrypt, bool,
 		data->len -= padlen + 1;
 	}
 
-	bs = this->signer->get_block_size(this->signer);
+	bs = this->mac_size;
 	if (data->len < bs)
 	{
 		return FALSE;
@@ -165,17 +181,17 @@ METHOD(tls_aead_t, get_encr_key_size, size_t,
 METHOD(tls_aead_t, get_iv_size, size_t,
 	private_tls_aead_t *this)
 {
-	return this->iv.len;
+	return this->iv_size;
 }
 
 METHOD(tls_aead_t, set_keys, bool,
 	private_tls_aead_t *this, chunk_t mac, chunk_t encr, chunk_t iv)
 {
-	if (iv.len != this->iv.len)
+	if (iv.len != this->iv_size)
 	{
 		return FALSE;
 	}
-	memcpy(this->iv.ptr, iv.ptr, this->iv.len);
+	memcpy(this->iv, iv.ptr, this->iv_size);
 	return this->signer->set_key(this->signer, mac) &&
 		   this->crypter->set_key(this->crypter, encr);
 }
@@ -185,7 +201,6 @@ METHOD(tls_aead_t, destroy, void,
 {
 	DESTROY_IF(this->crypter);
 	DESTROY_IF(this->signer);
-	chunk_free(&this->iv);
 	free(this);
 }
 
@@ -217,7 +232,17 @@ tls_aead_t *tls_aead_create_implicit(integrity_algorithm_t mac,
 		return NULL;
 	}
 
-	this->iv = chunk_alloc(this->crypter->get_iv_size(this->crypter));
+	if (this->crypter->get_iv_size(this->crypter) > sizeof(this->iv))
+	{
+		destroy(this);
+		return NULL;
+	}
+
+	/* these are constant for the lifetime of the transform, avoid querying
+	 * them again for every record */
+	this->iv_size = this->crypter->get_iv_size(this->crypter);
+	this->block_size = this->crypter->get_block_size(this->crypter);
+	this->mac_size = this->signer->get_block_size(this->signer);
 
 	return &this->public;
 }
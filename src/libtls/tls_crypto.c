@@ -427,6 +427,11 @@ struct private_tls_crypto_t {
 	 */
 	tls_cipher_suite_t suite;
 
+	/**
+	 * Negotiated encrypt-then-MAC for the selected suite? (RFC 7366)
+	 */
+	bool encrypt_then_mac;
+
 	/**
 	 * RSA supported?
 	 */
@@ -479,16 +484,16 @@ struct private_tls_crypto_t {
 };
 
 typedef struct {
-	tls_cipher_suite_t suite;
+	uint16_t suite;
 	key_type_t key;
 	key_exchange_method_t dh;
 	hash_algorithm_t hash;
 	pseudo_random_function_t prf;
 	integrity_algorithm_t mac;
 	encryption_algorithm_t encr;
-	size_t encr_size;
-	tls_version_t min_version;
-	tls_version_t max_version;
+	uint8_t encr_size;
+	uint16_t min_version;
+	uint16_t max_version;
 } suite_algs_t;
 
 /**
@@ -498,7 +503,7 @@ typedef struct {
  * this rule set:
  *
  *   1. TLS 1.3 > Legacy TLS
- *   2. AES > CAMELLIA > NULL
+ *   2. AES > CHACHA20 > CAMELLIA > NULL
  *   3. AES256 > AES128
  *   4. GCM > CBC
  *   5. ECDHE > DHE > NULL
@@ -506,7 +511,7 @@ typedef struct {
  *   7. SHA384 > SHA256 > SHA1
  *
  */
-static suite_algs_t suite_algs[] = {
+static const suite_algs_t suite_algs[] = {
 	/* Cipher suites of TLS 1.3: key exchange and authentication
 	 * delegated to extensions, therefore KEY_ANY, KE_NONE, PRF_UNDEFINED */
 	{ TLS_AES_256_GCM_SHA384,
@@ -576,6 +581,12 @@ static suite_algs_t suite_algs[] = {
 		AUTH_HMAC_SHA1_160, ENCR_AES_CBC, 16,
 		TLS_1_0, TLS_1_2,
 	},
+	{ TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+		KEY_ECDSA, ECP_256_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_CHACHA20_POLY1305, 32,
+		TLS_1_2, TLS_1_2,
+	},
 	{ TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
 		KEY_RSA, ECP_384_BIT,
 		HASH_SHA384, PRF_HMAC_SHA2_384,
@@ -612,6 +623,12 @@ static suite_algs_t suite_algs[] = {
 		AUTH_HMAC_SHA1_160, ENCR_AES_CBC, 16,
 		TLS_1_0, TLS_1_2,
 	},
+	{ TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+		KEY_RSA, ECP_256_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_CHACHA20_POLY1305, 32,
+		TLS_1_2, TLS_1_2,
+	},
 	{ TLS_DHE_RSA_WITH_AES_256_GCM_SHA384,
 		KEY_RSA, MODP_4096_BIT,
 		HASH_SHA384, PRF_HMAC_SHA2_384,
@@ -660,6 +677,12 @@ static suite_algs_t suite_algs[] = {
 		AUTH_HMAC_SHA1_160, ENCR_AES_CBC, 16,
 		SSL_3_0, TLS_1_2,
 	},
+	{ TLS_DHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+		KEY_RSA, MODP_3072_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_CHACHA20_POLY1305, 32,
+		TLS_1_2, TLS_1_2,
+	},
 	{ TLS_DHE_RSA_WITH_CAMELLIA_128_CBC_SHA256,
 		KEY_RSA, MODP_3072_BIT,
 		HASH_SHA256, PRF_HMAC_SHA2_256,
@@ -761,10 +784,155 @@ static suite_algs_t suite_algs[] = {
 /**
  * Look up algorithms by a suite
  */
-static suite_algs_t *find_suite(tls_cipher_suite_t suite)
+static const suite_algs_t *find_suite(tls_cipher_suite_t suite)
 {
-	int i;
+	int i = -1;
 
+	/* direct mapping to the corresponding row in suite_algs[], letting the
+	 * compiler emit a jump table instead of walking the table. The result
+	 * is verified below, so a missed update here degrades to the linear
+	 * scan instead of returning a wrong entry. */
+	switch (suite)
+	{
+		case TLS_AES_256_GCM_SHA384:
+			i = 0;
+			break;
+		case TLS_AES_128_GCM_SHA256:
+			i = 1;
+			break;
+		case TLS_CHACHA20_POLY1305_SHA256:
+			i = 2;
+			break;
+		case TLS_AES_128_CCM_SHA256:
+			i = 3;
+			break;
+		case TLS_AES_128_CCM_8_SHA256:
+			i = 4;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384:
+			i = 5;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA384:
+			i = 6;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA:
+			i = 7;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256:
+			i = 8;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256:
+			i = 9;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA:
+			i = 10;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256:
+			i = 11;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384:
+			i = 12;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA384:
+			i = 13;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA:
+			i = 14;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256:
+			i = 15;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256:
+			i = 16;
+			break;
+		case TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA:
+			i = 17;
+			break;
+		case TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256:
+			i = 18;
+			break;
+		case TLS_DHE_RSA_WITH_AES_256_GCM_SHA384:
+			i = 19;
+			break;
+		case TLS_DHE_RSA_WITH_AES_256_CBC_SHA256:
+			i = 20;
+			break;
+		case TLS_DHE_RSA_WITH_AES_256_CBC_SHA:
+			i = 21;
+			break;
+		case TLS_DHE_RSA_WITH_CAMELLIA_256_CBC_SHA256:
+			i = 22;
+			break;
+		case TLS_DHE_RSA_WITH_CAMELLIA_256_CBC_SHA:
+			i = 23;
+			break;
+		case TLS_DHE_RSA_WITH_AES_128_GCM_SHA256:
+			i = 24;
+			break;
+		case TLS_DHE_RSA_WITH_AES_128_CBC_SHA256:
+			i = 25;
+			break;
+		case TLS_DHE_RSA_WITH_AES_128_CBC_SHA:
+			i = 26;
+			break;
+		case TLS_DHE_RSA_WITH_CHACHA20_POLY1305_SHA256:
+			i = 27;
+			break;
+		case TLS_DHE_RSA_WITH_CAMELLIA_128_CBC_SHA256:
+			i = 28;
+			break;
+		case TLS_DHE_RSA_WITH_CAMELLIA_128_CBC_SHA:
+			i = 29;
+			break;
+		case TLS_RSA_WITH_AES_256_GCM_SHA384:
+			i = 30;
+			break;
+		case TLS_RSA_WITH_AES_256_CBC_SHA256:
+			i = 31;
+			break;
+		case TLS_RSA_WITH_AES_256_CBC_SHA:
+			i = 32;
+			break;
+		case TLS_RSA_WITH_AES_128_GCM_SHA256:
+			i = 33;
+			break;
+		case TLS_RSA_WITH_AES_128_CBC_SHA256:
+			i = 34;
+			break;
+		case TLS_RSA_WITH_AES_128_CBC_SHA:
+			i = 35;
+			break;
+		case TLS_RSA_WITH_CAMELLIA_256_CBC_SHA256:
+			i = 36;
+			break;
+		case TLS_RSA_WITH_CAMELLIA_256_CBC_SHA:
+			i = 37;
+			break;
+		case TLS_RSA_WITH_CAMELLIA_128_CBC_SHA256:
+			i = 38;
+			break;
+		case TLS_RSA_WITH_CAMELLIA_128_CBC_SHA:
+			i = 39;
+			break;
+		case TLS_ECDHE_ECDSA_WITH_NULL_SHA:
+			i = 40;
+			break;
+		case TLS_ECDHE_RSA_WITH_NULL_SHA:
+			i = 41;
+			break;
+		case TLS_RSA_WITH_NULL_SHA256:
+			i = 42;
+			break;
+		case TLS_RSA_WITH_NULL_SHA:
+			i = 43;
+			break;
+		default:
+			break;
+	}
+	if (i >= 0 && i < countof(suite_algs) && suite_algs[i].suite == suite)
+	{
+		return &suite_algs[i];
+	}
 	for (i = 0; i < countof(suite_algs); i++)
 	{
 		if (suite_algs[i].suite == suite)
@@ -783,12 +951,22 @@ static void filter_suite(suite_algs_t suites[], int *count, int offset,
 {
 	const char *plugin_name;
 	suite_algs_t current;
-	int *current_alg, i, remaining = 0;
+	int registered[256];
+	int *current_alg, i, j, algs = 0, remaining = 0;
 	enumerator_t *enumerator;
 
 	memset(&current, 0, sizeof(current));
 	current_alg = (int*)((char*)&current + offset);
 
+	/* enumerate the registered algorithms once, not once per suite */
+	enumerator = create_enumerator(lib->crypto);
+	while (algs < countof(registered) &&
+		   enumerator->enumerate(enumerator, current_alg, &plugin_name))
+	{
+		registered[algs++] = *current_alg;
+	}
+	enumerator->destroy(enumerator);
+
 	for (i = 0; i < *count; i++)
 	{
 		if (create_enumerator == lib->crypto->create_crypter_enumerator &&
@@ -805,9 +983,9 @@ static void filter_suite(suite_algs_t suites[], int *count, int offset,
 			remaining++;
 			continue;
 		}
-		enumerator = create_enumerator(lib->crypto);
-		while (enumerator->enumerate(enumerator, current_alg, &plugin_name))
+		for (j = 0; j < algs; j++)
 		{
+			*current_alg = registered[j];
 			if (current.encr && current.encr != suites[i].encr)
 			{
 				if (suites[i].encr != ENCR_NULL)
@@ -848,7 +1026,6 @@ static void filter_suite(suite_algs_t suites[], int *count, int offset,
 			remaining++;
 			break;
 		}
-		enumerator->destroy(enumerator);
 	}
 	*count = remaining;
 }
@@ -1212,7 +1389,7 @@ METHOD(tls_crypto_t, get_cipher_suites, int,
 /**
  * Create NULL encryption transforms
  */
-static bool create_null(private_tls_crypto_t *this, suite_algs_t *algs)
+static bool create_null(private_tls_crypto_t *this, const suite_algs_t *algs)
 {
 	this->aead_in = tls_aead_create_null(algs->mac);
 	this->aead_out = tls_aead_create_null(algs->mac);
@@ -1228,7 +1405,8 @@ static bool create_null(private_tls_crypto_t *this, suite_algs_t *algs)
 /**
  * Create traditional transforms
  */
-static bool create_traditional(private_tls_crypto_t *this, suite_algs_t *algs)
+static bool create_traditional(private_tls_crypto_t *this,
+							   const suite_algs_t *algs)
 {
 	if (this->tls->get_version_max(this->tls) < TLS_1_1)
 	{
@@ -1237,6 +1415,13 @@ static bool create_traditional(private_tls_crypto_t *this, suite_algs_t *algs)
 		this->aead_out = tls_aead_create_implicit(algs->mac,
 								algs->encr, algs->encr_size);
 	}
+	else if (this->encrypt_then_mac)
+	{
+		this->aead_in = tls_aead_create_etm(algs->mac,
+								algs->encr, algs->encr_size);
+		this->aead_out = tls_aead_create_etm(algs->mac,
+								algs->encr, algs->encr_size);
+	}
 	else
 	{
 		this->aead_in = tls_aead_create_explicit(algs->mac,
@@ -1257,12 +1442,20 @@ static bool create_traditional(private_tls_crypto_t *this, suite_algs_t *algs)
 /**
  * Create AEAD transforms
  */
-static bool create_aead(private_tls_crypto_t *this, suite_algs_t *algs)
+static bool create_aead(private_tls_crypto_t *this, const suite_algs_t *algs)
 {
 	if (this->tls->get_version_max(this->tls) < TLS_1_3)
 	{
-		this->aead_in = tls_aead_create_aead(algs->encr, algs->encr_size);
-		this->aead_out = tls_aead_create_aead(algs->encr, algs->encr_size);
+		if (algs->encr == ENCR_CHACHA20_POLY1305)
+		{	/* ChaCha20-Poly1305 uses an XORed nonce also in TLS 1.2 */
+			this->aead_in = tls_aead_create_xor(algs->encr, algs->encr_size);
+			this->aead_out = tls_aead_create_xor(algs->encr, algs->encr_size);
+		}
+		else
+		{
+			this->aead_in = tls_aead_create_aead(algs->encr, algs->encr_size);
+			this->aead_out = tls_aead_create_aead(algs->encr, algs->encr_size);
+		}
 	}
 	else
 	{
@@ -1291,7 +1484,7 @@ static void destroy_aeads(private_tls_crypto_t *this)
 /**
  * Create crypto primitives
  */
-static bool create_ciphers(private_tls_crypto_t *this, suite_algs_t *algs)
+static bool create_ciphers(private_tls_crypto_t *this, const suite_algs_t *algs)
 {
 	destroy_aeads(this);
 	DESTROY_IF(this->hkdf);
@@ -1350,28 +1543,37 @@ METHOD(tls_crypto_t, select_cipher_suite, tls_cipher_suite_t,
 	private_tls_crypto_t *this, tls_cipher_suite_t *suites, int count,
 	key_type_t key)
 {
-	suite_algs_t *algs;
-	int i, j;
+	const suite_algs_t *algs;
+	uint8_t offered[(UINT16_MAX + 1) / 8] = {};
+	uint16_t suite;
+	int i;
 
+	/* mark the suites offered by the peer in a bitmap over the 16-bit suite
+	 * ID space, so our preference list below is matched against it in a
+	 * single pass instead of rescanning the peer's list for each entry */
+	for (i = 0; i < count; i++)
+	{
+		suite = suites[i];
+		offered[suite / 8] |= 1 << (suite % 8);
+	}
 	for (i = 0; i < this->suite_count; i++)
 	{
-		for (j = 0; j < count; j++)
+		suite = this->suites[i];
+		if (!(offered[suite / 8] & 1 << (suite % 8)))
 		{
-			if (this->suites[i] == suites[j])
+			continue;
+		}
+		algs = find_suite(this->suites[i]);
+		if (algs)
+		{
+			if (key == KEY_ANY || key == algs->key ||
+				(algs->key == KEY_ECDSA && key == KEY_ED25519) ||
+				(algs->key == KEY_ECDSA && key == KEY_ED448))
 			{
-				algs = find_suite(this->suites[i]);
-				if (algs)
+				if (create_ciphers(this, algs))
 				{
-					if (key == KEY_ANY || key == algs->key ||
-						(algs->key == KEY_ECDSA && key == KEY_ED25519) ||
-						(algs->key == KEY_ECDSA && key == KEY_ED448))
-					{
-						if (create_ciphers(this, algs))
-						{
-							this->suite = this->suites[i];
-							return this->suite;
-						}
-					}
+					this->suite = this->suites[i];
+					return this->suite;
 				}
 			}
 		}
@@ -1379,6 +1581,27 @@ METHOD(tls_crypto_t, select_cipher_suite, tls_cipher_suite_t,
 	return 0;
 }
 
+METHOD(tls_crypto_t, use_encrypt_then_mac, void,
+	private_tls_crypto_t *this)
+{
+	this->encrypt_then_mac = TRUE;
+}
+
+METHOD(tls_crypto_t, get_encrypt_then_mac, bool,
+	private_tls_crypto_t *this)
+{
+	const suite_algs_t *algs;
+	tls_version_t version;
+
+	version = this->tls->get_version_max(this->tls);
+	algs = find_suite(this->suite);
+	/* the extension only applies to CBC suites, see RFC 7366, section 3 */
+	return this->encrypt_then_mac && algs &&
+		   version >= TLS_1_1 && version < TLS_1_3 &&
+		   algs->encr != ENCR_NULL &&
+		   !encryption_algorithm_is_aead(algs->encr);
+}
+
 /**
  * Parameters for RSA/PSS signature schemes
  */
@@ -1633,7 +1856,7 @@ static key_exchange_method_t supported_ec_group(private_tls_crypto_t *this,
 METHOD(tls_crypto_t, get_dh_group, key_exchange_method_t,
 	private_tls_crypto_t *this)
 {
-	suite_algs_t *algs;
+	const suite_algs_t *algs;
 
 	algs = find_suite(this->suite);
 	if (algs)
@@ -1672,7 +1895,7 @@ static bool hash_data(private_tls_crypto_t *this, chunk_t data, chunk_t *hash)
 	if (this->tls->get_version_max(this->tls) >= TLS_1_2)
 	{
 		hasher_t *hasher;
-		suite_algs_t *alg;
+		const suite_algs_t *alg;
 
 		alg = find_suite(this->suite);
 		if (!alg)
@@ -2134,6 +2357,7 @@ static bool derive_master(private_tls_crypto_t *this, chunk_t premaster,
 							  sizeof(master), master) ||
 		!this->prf->set_key(this->prf, chunk_from_thing(master)))
 	{
+		memwipe(master, sizeof(master));
 		return FALSE;
 	}
 
@@ -2152,10 +2376,11 @@ static bool derive_master(private_tls_crypto_t *this, chunk_t premaster,
 static bool expand_keys(private_tls_crypto_t *this,
 						chunk_t client_random, chunk_t server_random)
 {
-	chunk_t seed, block;
+	chunk_t seed, block, keys;
 	chunk_t cw_mac, cw, cw_iv;
 	chunk_t sw_mac, sw, sw_iv;
 	int mklen, eklen, ivlen;
+	bool success;
 
 	if (!this->aead_in || !this->aead_out)
 	{
@@ -2167,10 +2392,11 @@ static bool expand_keys(private_tls_crypto_t *this,
 	eklen = this->aead_in->get_encr_key_size(this->aead_in);
 	ivlen = this->aead_in->get_iv_size(this->aead_in);
 	seed = chunk_cata("cc", server_random, client_random);
-	block = chunk_alloca((mklen + eklen + ivlen) * 2);
+	keys = block = chunk_alloca((mklen + eklen + ivlen) * 2);
 	if (!this->prf->get_bytes(this->prf, "key expansion", seed,
 							  block.len, block.ptr))
 	{
+		memwipe(keys.ptr, keys.len);
 		return FALSE;
 	}
 
@@ -2194,19 +2420,19 @@ static bool expand_keys(private_tls_crypto_t *this,
 
 	if (this->tls->is_server(this->tls))
 	{
-		if (!this->aead_in->set_keys(this->aead_in, cw_mac, cw, cw_iv) ||
-			!this->aead_out->set_keys(this->aead_out, sw_mac, sw, sw_iv))
-		{
-			return FALSE;
-		}
+		success = this->aead_in->set_keys(this->aead_in, cw_mac, cw, cw_iv) &&
+				  this->aead_out->set_keys(this->aead_out, sw_mac, sw, sw_iv);
 	}
 	else
 	{
-		if (!this->aead_out->set_keys(this->aead_out, cw_mac, cw, cw_iv) ||
-			!this->aead_in->set_keys(this->aead_in, sw_mac, sw, sw_iv))
-		{
-			return FALSE;
-		}
+		success = this->aead_out->set_keys(this->aead_out, cw_mac, cw, cw_iv) &&
+				  this->aead_in->set_keys(this->aead_in, sw_mac, sw, sw_iv);
+	}
+	/* the transforms keep copies of the keys, wipe them from the stack */
+	memwipe(keys.ptr, keys.len);
+	if (!success)
+	{
+		return FALSE;
 	}
 
 	/* EAP-MSK */
@@ -2273,7 +2499,7 @@ static bool derive_labeled_keys(private_tls_crypto_t *this,
 								tls_hkdf_label_t server_label)
 {
 	tls_aead_t *aead_c, *aead_s;
-	suite_algs_t *algs;
+	const suite_algs_t *algs;
 
 	algs = find_suite(this->suite);
 	destroy_aeads(this);
@@ -2344,7 +2570,7 @@ METHOD(tls_crypto_t, derive_app_keys, bool,
 METHOD(tls_crypto_t, update_app_keys, bool,
 	private_tls_crypto_t *this, bool inbound)
 {
-	suite_algs_t *algs;
+	const suite_algs_t *algs;
 	tls_hkdf_label_t label = TLS_HKDF_UPD_C_TRAFFIC;
 
 	algs = find_suite(this->suite);
@@ -2448,6 +2674,8 @@ tls_crypto_t *tls_crypto_create(tls_t *tls, tls_cache_t *cache)
 		.public = {
 			.get_cipher_suites = _get_cipher_suites,
 			.select_cipher_suite = _select_cipher_suite,
+			.use_encrypt_then_mac = _use_encrypt_then_mac,
+			.get_encrypt_then_mac = _get_encrypt_then_mac,
 			.get_dh_group = _get_dh_group,
 			.get_signature_algorithms = _get_signature_algorithms,
 			.create_ec_enumerator = _create_ec_enumerator,
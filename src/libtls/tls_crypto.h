@@ -461,6 +461,22 @@ struct tls_crypto_t {
 										tls_cipher_suite_t *suites, int count,
 										key_type_t key);
 
+	/**
+	 * Use encrypt-then-MAC for CBC cipher suites negotiated later on.
+	 *
+	 * Called when the encrypt_then_mac extension (RFC 7366) has been
+	 * received, before the cipher suite is selected and the transforms get
+	 * keyed. Has no effect on suites the extension does not apply to.
+	 */
+	void (*use_encrypt_then_mac)(tls_crypto_t *this);
+
+	/**
+	 * Check if encrypt-then-MAC is in effect for the selected cipher suite.
+	 *
+	 * @return				TRUE if transforms use encrypt-then-MAC
+	 */
+	bool (*get_encrypt_then_mac)(tls_crypto_t *this);
+
 	/**
 	 * Get the Diffie-Hellman group to use, if any.
 	 *
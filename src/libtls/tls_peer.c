@@ -217,7 +217,7 @@ static status_t process_server_hello(private_tls_peer_t *this,
 	chunk_t cookie = chunk_empty;
 	tls_cipher_suite_t suite = 0;
 	tls_version_t version_max;
-	bool is_retry_request;
+	bool is_retry_request, etm = FALSE;
 
 	msg = reader->peek(reader);
 	if (!reader->read_uint16(reader, &version) ||
@@ -278,6 +278,9 @@ static status_t process_server_hello(private_tls_peer_t *this,
 					return NEED_MORE;
 				}
 				break;
+			case TLS_EXT_ENCRYPT_THEN_MAC:
+				etm = TRUE;
+				break;
 			case TLS_EXT_COOKIE:
 				if (!extension->read_data16(extension, &cookie))
 				{
@@ -320,6 +323,13 @@ static status_t process_server_hello(private_tls_peer_t *this,
 		return NEED_MORE;
 	}
 
+	if (etm && !is_retry_request)
+	{	/* must be decided before the transforms are created, and in
+		 * particular before they get keyed when resuming a session.  For
+		 * non-CBC suites, the extension has no effect (RFC 7366) */
+		this->crypto->use_encrypt_then_mac(this->crypto);
+	}
+
 	if (this->tls->get_version_max(this->tls) < TLS_1_3)
 	{
 		if (chunk_equals(this->session, session))
@@ -1367,6 +1377,14 @@ static status_t send_client_hello(private_tls_peer_t *this,
 		extensions->write_uint8(extensions, TLS_EC_POINT_UNCOMPRESSED);
 	}
 
+	if (version_min >= TLS_1_1 && version_min < TLS_1_3)
+	{	/* enable encrypt-then-MAC for CBC suites on legacy TLS versions */
+		DBG2(DBG_TLS, "sending extension: %N",
+			 tls_extension_names, TLS_EXT_ENCRYPT_THEN_MAC);
+		extensions->write_uint16(extensions, TLS_EXT_ENCRYPT_THEN_MAC);
+		extensions->write_data16(extensions, chunk_empty);
+	}
+
 	if (version_max >= TLS_1_3)
 	{
 		DBG2(DBG_TLS, "sending extension: %N",
@@ -167,6 +167,11 @@ struct private_tls_server_t {
 	 * Whether to include CAs in CertificateRequest messages
 	 */
 	bool send_certreq_authorities;
+
+	/**
+	 * Negotiated encrypt-then-MAC with the client? (RFC 7366)
+	 */
+	bool encrypt_then_mac;
 };
 
 /**
@@ -348,6 +353,7 @@ static status_t process_client_hello(private_tls_server_t *this,
 	tls_version_t original_version_max;
 	int count, i;
 	rng_t *rng;
+	bool etm = FALSE;
 
 	this->crypto->append_handshake(this->crypto,
 								   TLS_CLIENT_HELLO, reader->peek(reader));
@@ -423,6 +429,9 @@ static status_t process_client_hello(private_tls_server_t *this,
 					return NEED_MORE;
 				}
 				break;
+			case TLS_EXT_ENCRYPT_THEN_MAC:
+				etm = TRUE;
+				break;
 			case TLS_EXT_KEY_SHARE:
 				if (!extension->read_data16(extension, &key_shares))
 				{
@@ -515,6 +524,12 @@ static status_t process_client_hello(private_tls_server_t *this,
 		return NEED_MORE;
 	}
 
+	if (etm)
+	{	/* must be decided before the transforms are created, and in
+		 * particular before they get keyed when resuming a session */
+		this->crypto->use_encrypt_then_mac(this->crypto);
+	}
+
 	if (this->tls->get_version_max(this->tls) < TLS_1_3)
 	{
 		this->suite = this->crypto->resume_session(this->crypto, session,
@@ -576,6 +591,10 @@ static status_t process_client_hello(private_tls_server_t *this,
 			 tls_cipher_suite_names, this->suite);
 	}
 
+	/* announce encrypt-then-MAC in the ServerHello if the client offered it
+	 * and it applies to the selected suite */
+	this->encrypt_then_mac = this->crypto->get_encrypt_then_mac(this->crypto);
+
 	if (this->tls->get_version_max(this->tls) >= TLS_1_3)
 	{
 		key_exchange_method_t group;
@@ -1260,6 +1279,18 @@ static status_t send_server_hello(private_tls_server_t *this,
 		writer->write_data16(writer, extensions->get_buf(extensions));
 		extensions->destroy(extensions);
 	}
+	else if (this->encrypt_then_mac)
+	{
+		extensions = bio_writer_create(8);
+
+		DBG2(DBG_TLS, "sending extension: %N",
+			 tls_extension_names, TLS_EXT_ENCRYPT_THEN_MAC);
+		extensions->write_uint16(extensions, TLS_EXT_ENCRYPT_THEN_MAC);
+		extensions->write_data16(extensions, chunk_empty);
+
+		writer->write_data16(writer, extensions->get_buf(extensions));
+		extensions->destroy(extensions);
+	}
 
 	*type = TLS_SERVER_HELLO;
 	this->state = this->requested_curve ? STATE_INIT : STATE_HELLO_SENT;